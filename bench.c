@@ -0,0 +1,206 @@
+/* bench.c */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "perlin.h"
+#include "simplex.h"
+#include "worley.h"
+#include "field.h"
+#include "fbm.h"
+#include "misc.h"
+
+
+#define WIDTH   512
+#define HEIGHT  512
+#define FRAMES   8
+
+#define FIELD_SIZE   2048
+#define FIELD_TILE     64
+#define FIELD_READS  4096
+
+
+static float sink;
+
+static double
+now()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + 1e-9*ts.tv_nsec;
+}
+
+static void
+report(const char *name, double seconds, double samples)
+{
+	printf("%-24s %8.2f Msamples/s\n", name, samples/seconds/1e6);
+}
+
+static void
+bench_noise3d(const char *name, noise3d_func noise3d)
+{
+	double before = now();
+	for (int f = 0; f < FRAMES; f++) {
+		for (int y = 0; y < HEIGHT; y++) {
+			for (int x = 0; x < WIDTH; x++) {
+				sink += noise3d((16.0*x)/HEIGHT, (16.0*y)/HEIGHT, 0.1*f);
+			}
+		}
+	}
+	report(name, now() - before, (double)FRAMES*WIDTH*HEIGHT);
+}
+
+static void
+bench_fbm3d(const char *name, float zoom)
+{
+	float footprint = 1.0/(zoom*HEIGHT);
+	int octaves = 4 + max(0, (int)log2f(zoom));
+
+	double before = now();
+	for (int f = 0; f < FRAMES; f++) {
+		for (int y = 0; y < HEIGHT; y++) {
+			for (int x = 0; x < WIDTH; x++) {
+				sink += fbm3d(perlin3d, x*footprint, y*footprint, 0.1*f, footprint, octaves);
+			}
+		}
+	}
+	report(name, now() - before, (double)FRAMES*WIDTH*HEIGHT);
+}
+
+/* Fill a FIELD_SIZE square with fBm, either directly or by evaluating one
+   periodic tile and replicating it */
+static void
+bench_tiled(const char *name, int tile)
+{
+	static float dest[FIELD_SIZE*FIELD_SIZE];
+	float footprint = 1.0/256;
+	float period = tile*footprint;
+
+	double before = now();
+	for (int y = 0; y < tile; y++) {
+		for (int x = 0; x < tile; x++) {
+			if (tile < FIELD_SIZE) dest[y*FIELD_SIZE+x] = fbm3d_periodic(perlin3d_periodic, x*footprint, y*footprint, 0.0, footprint, 4, period, period);
+			else dest[y*FIELD_SIZE+x] = fbm3d(perlin3d, x*footprint, y*footprint, 0.0, footprint, 4);
+		}
+	}
+	for (int y = 0; y < tile; y++) {
+		for (int x = tile; x < FIELD_SIZE; x += tile) {
+			memcpy(&dest[y*FIELD_SIZE+x], &dest[y*FIELD_SIZE], sizeof(float)*tile);
+		}
+	}
+	for (int y = tile; y < FIELD_SIZE; y++) {
+		memcpy(&dest[y*FIELD_SIZE], &dest[(y-tile)*FIELD_SIZE], sizeof(float)*FIELD_SIZE);
+	}
+	report(name, now() - before, (double)FIELD_SIZE*FIELD_SIZE);
+}
+
+static void
+bench_worley3d_batch()
+{
+	static float x[WIDTH], y[WIDTH], z[WIDTH];
+	static float dest[WIDTH];
+
+	double before = now();
+	for (int f = 0; f < FRAMES; f++) {
+		for (int j = 0; j < HEIGHT; j++) {
+			for (int i = 0; i < WIDTH; i++) {
+				x[i] = (16.0*i)/HEIGHT;
+				y[i] = (16.0*j)/HEIGHT;
+				z[i] = 0.1*f;
+			}
+			worley3d_batch(dest, x, y, z, WIDTH, WORLEY_F1);
+			sink += dest[0];
+		}
+	}
+	report("worley3d_batch", now() - before, (double)FRAMES*WIDTH*HEIGHT);
+}
+
+static void
+report_mb(const char *name, double seconds, double bytes)
+{
+	printf("%-24s %8.2f MB/s\n", name, bytes/seconds/1e6);
+}
+
+static void
+bench_field(const char *name, const float src[], int encoding, int flags)
+{
+	static float dest[FIELD_SIZE*FIELD_SIZE];
+	static float tile[FIELD_TILE*FIELD_TILE];
+	const char *path = "bench.fld";
+	const double bytes = (double)FIELD_SIZE*FIELD_SIZE*sizeof(float);
+
+	double before = now();
+	if (field_write(path, src, FIELD_SIZE, FIELD_SIZE, FIELD_TILE, encoding, flags) < 0) {
+		perror("field_write");
+		exit(1);
+	}
+	double written = now() - before;
+
+	struct field field;
+	if (field_open(&field, path) < 0) {
+		perror("field_open");
+		exit(1);
+	}
+
+	before = now();
+	if (field_read(&field, dest) < 0) {
+		perror("field_read");
+		exit(1);
+	}
+	double read = now() - before;
+
+	int tiles = FIELD_SIZE/FIELD_TILE;
+	before = now();
+	for (int i = 0; i < FIELD_READS; i++) {
+		if (field_read_tile(&field, tile, FIELD_TILE, rand() % tiles, rand() % tiles) < 0) {
+			perror("field_read_tile");
+			exit(1);
+		}
+		sink += tile[0];
+	}
+	double tile_read = now() - before;
+
+	float err = 0.0;
+	for (int i = 0; i < FIELD_SIZE*FIELD_SIZE; i++) err = max(err, fabsf(dest[i] - src[i]));
+
+	printf("%s: %.2f bytes/sample, max error %g\n", name, (double)field.size/(FIELD_SIZE*FIELD_SIZE), err);
+	field_close(&field);
+	unlink(path);
+
+	report_mb("  write", written, bytes);
+	report_mb("  full read", read, bytes);
+	report_mb("  random tile read", tile_read, (double)FIELD_READS*FIELD_TILE*FIELD_TILE*sizeof(float));
+}
+
+int
+main(int argc, char* argv[])
+{
+	bench_noise3d("perlin3d", perlin3d);
+	bench_noise3d("simplex3d", simplex3d);
+	bench_noise3d("worley3d_f1", worley3d_f1);
+	bench_worley3d_batch();
+	bench_fbm3d("fbm3d zoom 1/64", 1.0/64);
+	bench_fbm3d("fbm3d zoom 1", 1.0);
+	bench_fbm3d("fbm3d zoom 16", 16.0);
+
+	static float src[FIELD_SIZE*FIELD_SIZE];
+	for (int y = 0; y < FIELD_SIZE; y++) {
+		for (int x = 0; x < FIELD_SIZE; x++) {
+			src[y*FIELD_SIZE+x] = 0.5*perlin3d((16.0*x)/FIELD_SIZE, (16.0*y)/FIELD_SIZE, 0.0) + 0.5;
+		}
+	}
+
+	bench_tiled("fbm3d 2048^2 full", FIELD_SIZE);
+	bench_tiled("fbm3d 2048^2 tile 256", 256);
+
+	bench_field("field fp16", src, FIELD_FP16, 0);
+	bench_field("field fp16+delta", src, FIELD_FP16, FIELD_DELTA);
+	bench_field("field u16", src, FIELD_U16, 0);
+	bench_field("field u16+delta", src, FIELD_U16, FIELD_DELTA);
+
+	return sink == 0.12345f;
+}
@@ -0,0 +1,90 @@
+/* fbm.c */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+
+#include "fbm.h"
+#include "misc.h"
+
+
+/* Octaves are kept at full weight up to half the Nyquist frequency and
+   faded linearly to zero at the Nyquist frequency. */
+#define FADE_START  0.25
+#define FADE_END    0.5
+
+float __attribute__ ((const))
+fbm_octave_weight(float frequency, float footprint)
+{
+	float f = frequency*footprint;
+	if (f <= FADE_START) return 1.0;
+	if (f >= FADE_END) return 0.0;
+	return (FADE_END - f)/(FADE_END - FADE_START);
+}
+
+/* Sum octaves of noise3d, or of periodic if it is not NULL. The faded
+   part of each octave is replaced by mean, the expected value of the
+   octave, and the sum is normalised by the amplitudes of all octaves so
+   the output fades smoothly and keeps its contrast as octaves drop out. */
+static inline float __attribute__ ((always_inline))
+octave_sum(noise3d_func noise3d, noise3d_periodic_func periodic, float x, float y, float z,
+	   float footprint, int octaves, int turbulence, float mean, float tile_x, float tile_y)
+{
+	float sum = 0.0;
+	float amplitude_sum = 0.0;
+
+	for (int l = 1; l <= octaves; l++) {
+		float frequency = (float)(1 << l);
+		float amplitude = 1.0/frequency;
+		float w = fbm_octave_weight(frequency, footprint);
+		amplitude_sum += amplitude;
+
+		int px = 0, py = 0;
+		if (periodic != NULL) {
+			px = (int)(frequency*tile_x + 0.5);
+			py = (int)(frequency*tile_y + 0.5);
+			if (px > FBM_MAX_PERIOD || py > FBM_MAX_PERIOD) w = 0.0;
+		}
+
+		if (w == 0.0) {
+			sum += amplitude*mean;
+			continue;
+		}
+
+		float n;
+		if (periodic != NULL) {
+			n = periodic(frequency*x, frequency*y, z, px, py, 0);
+		} else {
+			n = noise3d(frequency*x, frequency*y, z);
+		}
+		if (turbulence) n = fabsf(n);
+
+		sum += amplitude*(w*n + (1.0 - w)*mean);
+	}
+
+	return (amplitude_sum > 0.0) ? sum/amplitude_sum : 0.0;
+}
+
+float
+fbm3d(noise3d_func noise3d, float x, float y, float z, float footprint, int octaves)
+{
+	return octave_sum(noise3d, NULL, x, y, z, footprint, octaves, 0, 0.0, 0.0, 0.0);
+}
+
+float
+turbulence3d(noise3d_func noise3d, float x, float y, float z, float footprint, int octaves, float mean)
+{
+	return octave_sum(noise3d, NULL, x, y, z, footprint, octaves, 1, mean, 0.0, 0.0);
+}
+
+float
+fbm3d_periodic(noise3d_periodic_func noise3d, float x, float y, float z, float footprint, int octaves, float tile_x, float tile_y)
+{
+	return octave_sum(NULL, noise3d, x, y, z, footprint, octaves, 0, 0.0, tile_x, tile_y);
+}
+
+float
+turbulence3d_periodic(noise3d_periodic_func noise3d, float x, float y, float z, float footprint, int octaves, float mean, float tile_x, float tile_y)
+{
+	return octave_sum(NULL, noise3d, x, y, z, footprint, octaves, 1, mean, tile_x, tile_y);
+}
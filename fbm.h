@@ -0,0 +1,38 @@
+/* fbm.h */
+
+#ifndef _FBM_H
+#define _FBM_H
+
+typedef float (*noise3d_func)(float x, float y, float z);
+typedef float (*noise3d_periodic_func)(float x, float y, float z, int px, int py, int pz);
+
+/* Weight of an octave of the given frequency when samples are footprint
+   apart: 1 well below the Nyquist limit, fading to 0 at the limit. */
+float __attribute__ ((const))
+fbm_octave_weight(float frequency, float footprint);
+
+/* Sum of octaves 1 to octaves of noise3d at frequency 2^l and amplitude
+   2^-l, normalised to the range of noise3d. Octaves that would alias at
+   the given footprint are faded to their mean and not evaluated. */
+float
+fbm3d(noise3d_func noise3d, float x, float y, float z, float footprint, int octaves);
+
+/* As fbm3d but summing the absolute value of each octave. Faded octaves
+   are replaced by mean, the expected absolute value of noise3d. */
+float
+turbulence3d(noise3d_func noise3d, float x, float y, float z, float footprint, int octaves, float mean);
+
+/* Largest octave period passed to the periodic noise function; this is
+   the lowest limit of perlin3d_periodic and simplex3d_periodic */
+#define FBM_MAX_PERIOD  256
+
+/* As fbm3d and turbulence3d but repeating every tile_x, tile_y units.
+   Octave l uses period 2^l*tile, which should be integral. Octaves whose
+   period would exceed FBM_MAX_PERIOD are culled like aliasing octaves. */
+float
+fbm3d_periodic(noise3d_periodic_func noise3d, float x, float y, float z, float footprint, int octaves, float tile_x, float tile_y);
+
+float
+turbulence3d_periodic(noise3d_periodic_func noise3d, float x, float y, float z, float footprint, int octaves, float mean, float tile_x, float tile_y);
+
+#endif /* !_FBM_H */
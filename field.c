@@ -0,0 +1,330 @@
+/* field.c */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "field.h"
+#include "misc.h"
+
+
+static uint16_t __attribute__ ((const))
+float_to_half(float f)
+{
+	union { float f; uint32_t u; } v = { f };
+	uint32_t sign = (v.u >> 16) & 0x8000;
+	int exp = ((v.u >> 23) & 0xff) - 127 + 15;
+	uint32_t mant = v.u & 0x7fffff;
+
+	if (((v.u >> 23) & 0xff) == 0xff) return sign | 0x7c00 | (mant ? 0x200 : 0);
+	if (exp >= 31) return sign | 0x7c00;
+	if (exp <= 0) {
+		/* Subnormal or zero */
+		if (exp < -10) return sign;
+		mant |= 0x800000;
+		uint32_t shift = 14 - exp;
+		uint32_t h = mant >> shift;
+		if ((mant >> (shift-1)) & 1) h += 1;
+		return sign | h;
+	}
+
+	uint32_t h = sign | (exp << 10) | (mant >> 13);
+	if (mant & 0x1000) h += 1;  /* Round, carrying into the exponent */
+	return h;
+}
+
+static float __attribute__ ((const))
+half_to_float(uint16_t h)
+{
+	union { float f; uint32_t u; } v;
+	uint32_t sign = (uint32_t)(h & 0x8000) << 16;
+	uint32_t exp = (h >> 10) & 0x1f;
+	uint32_t mant = h & 0x3ff;
+
+	if (exp == 0) {
+		v.f = mant*(1.0f/(1 << 24));
+		v.u |= sign;
+		return v.f;
+	}
+	if (exp == 31) v.u = sign | 0x7f800000 | (mant << 13);
+	else v.u = sign | ((exp - 15 + 127) << 23) | (mant << 13);
+	return v.f;
+}
+
+/* Encode tile values as uint16 codes, then either copy them out or
+   store zigzagged deltas as LEB128 varints. Returns the encoded size. */
+static size_t
+encode_tile(unsigned char *out, const uint16_t codes[], int n, int flags)
+{
+	if (!(flags & FIELD_DELTA)) {
+		memcpy(out, codes, n*sizeof(uint16_t));
+		return n*sizeof(uint16_t);
+	}
+
+	size_t size = 0;
+	uint16_t prev = 0;
+	for (int i = 0; i < n; i++) {
+		int16_t delta = (int16_t)(codes[i] - prev);
+		uint32_t zz = ((uint32_t)delta << 1) ^ (uint32_t)(delta >> 15);
+		zz &= 0xffff;
+		while (zz >= 0x80) {
+			out[size++] = (zz & 0x7f) | 0x80;
+			zz >>= 7;
+		}
+		out[size++] = zz;
+		prev = codes[i];
+	}
+	return size;
+}
+
+static int
+decode_tile(uint16_t codes[], int n, const unsigned char *in, size_t size, int flags)
+{
+	if (!(flags & FIELD_DELTA)) {
+		if (size != n*sizeof(uint16_t)) return -1;
+		memcpy(codes, in, size);
+		return 0;
+	}
+
+	size_t pos = 0;
+	uint16_t prev = 0;
+	for (int i = 0; i < n; i++) {
+		uint32_t zz = 0;
+		int shift = 0;
+		do {
+			if (pos >= size || shift > 14) return -1;
+			zz |= (uint32_t)(in[pos] & 0x7f) << shift;
+			shift += 7;
+		} while (in[pos++] & 0x80);
+		int16_t delta = (int16_t)((zz >> 1) ^ -(zz & 1));
+		prev = prev + delta;
+		codes[i] = prev;
+	}
+	return 0;
+}
+
+int
+field_write(const char *path, const float src[], int width, int height, int tile_size, int encoding, int flags)
+{
+	if (width <= 0 || height <= 0 || tile_size <= 0 || tile_size > FIELD_MAX_TILE ||
+	    (encoding != FIELD_FP16 && encoding != FIELD_U16)) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	struct field_header header;
+	memcpy(header.magic, FIELD_MAGIC, 4);
+	header.version = FIELD_VERSION;
+	header.encoding = encoding;
+	header.flags = flags;
+	header.width = width;
+	header.height = height;
+	header.tile_width = tile_size;
+	header.tile_height = tile_size;
+	header.tiles_x = (width + tile_size - 1) / tile_size;
+	header.tiles_y = (height + tile_size - 1) / tile_size;
+	header.reserved = 0;
+
+	int tiles = header.tiles_x*header.tiles_y;
+	int tile_n = tile_size*tile_size;
+
+	struct field_tile *index = calloc(tiles, sizeof(struct field_tile));
+	uint16_t *codes = malloc(tile_n*sizeof(uint16_t));
+	unsigned char *buf = malloc(3*tile_n);
+	FILE *f = fopen(path, "wb");
+	if (index == NULL || codes == NULL || buf == NULL || f == NULL) goto fail;
+
+	uint64_t offset = sizeof(header) + tiles*sizeof(struct field_tile);
+	if (fseek(f, offset, SEEK_SET) < 0) goto fail;
+
+	for (int ty = 0; ty < header.tiles_y; ty++) {
+		for (int tx = 0; tx < header.tiles_x; tx++) {
+			struct field_tile *tile = &index[ty*header.tiles_x+tx];
+			int x0 = tx*tile_size;
+			int y0 = ty*tile_size;
+			int tw = min(tile_size, width - x0);
+			int th = min(tile_size, height - y0);
+
+			if (encoding == FIELD_U16) {
+				float lo = INFINITY, hi = -INFINITY;
+				for (int y = 0; y < th; y++) {
+					for (int x = 0; x < tw; x++) {
+						float v = src[(y0+y)*width+x0+x];
+						lo = min(lo, v);
+						hi = max(hi, v);
+					}
+				}
+				tile->lo = lo;
+				tile->hi = hi;
+
+				float q = (hi > lo) ? 65535.0f/(hi - lo) : 0.0f;
+				for (int y = 0; y < th; y++) {
+					for (int x = 0; x < tw; x++) {
+						codes[y*tw+x] = (uint16_t)((src[(y0+y)*width+x0+x] - lo)*q + 0.5f);
+					}
+				}
+			} else {
+				for (int y = 0; y < th; y++) {
+					for (int x = 0; x < tw; x++) {
+						codes[y*tw+x] = float_to_half(src[(y0+y)*width+x0+x]);
+					}
+				}
+			}
+
+			size_t size = encode_tile(buf, codes, tw*th, flags);
+			if (fwrite(buf, 1, size, f) != size) goto fail;
+
+			tile->offset = offset;
+			tile->size = size;
+			offset += size;
+		}
+	}
+
+	if (fseek(f, 0, SEEK_SET) < 0 ||
+	    fwrite(&header, sizeof(header), 1, f) != 1 ||
+	    fwrite(index, sizeof(struct field_tile), tiles, f) != tiles) goto fail;
+
+	free(index);
+	free(codes);
+	free(buf);
+	return fclose(f) ? -1 : 0;
+
+fail:
+	{
+		int err = errno;
+		if (f != NULL) fclose(f);
+		free(index);
+		free(codes);
+		free(buf);
+		errno = err;
+	}
+	return -1;
+}
+
+int
+field_open(struct field *field, const char *path)
+{
+	int fd = open(path, O_RDONLY);
+	if (fd < 0) return -1;
+
+	struct stat st;
+	if (fstat(fd, &st) < 0) {
+		close(fd);
+		return -1;
+	}
+
+	void *map = MAP_FAILED;
+	if (st.st_size >= sizeof(struct field_header)) {
+		map = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+	}
+	close(fd);
+	if (map == MAP_FAILED) {
+		if (st.st_size < sizeof(struct field_header)) errno = EINVAL;
+		return -1;
+	}
+
+	const struct field_header *header = map;
+	size_t tiles = (size_t)header->tiles_x*header->tiles_y;
+	if (memcmp(header->magic, FIELD_MAGIC, 4) || header->version != FIELD_VERSION ||
+	    (header->encoding != FIELD_FP16 && header->encoding != FIELD_U16) ||
+	    header->width == 0 || header->height == 0 ||
+	    header->tile_width == 0 || header->tile_width > FIELD_MAX_TILE ||
+	    header->tile_height == 0 || header->tile_height > FIELD_MAX_TILE ||
+	    header->tiles_x != (header->width + header->tile_width - 1) / header->tile_width ||
+	    header->tiles_y != (header->height + header->tile_height - 1) / header->tile_height ||
+	    sizeof(*header) + tiles*sizeof(struct field_tile) > st.st_size) {
+		munmap(map, st.st_size);
+		errno = EINVAL;
+		return -1;
+	}
+
+	field->map = map;
+	field->size = st.st_size;
+	field->header = header;
+	field->index = (const struct field_tile *)(header + 1);
+	return 0;
+}
+
+void
+field_close(struct field *field)
+{
+	munmap(field->map, field->size);
+	field->map = NULL;
+}
+
+/* Decode one tile using codes as scratch space for tile_width*tile_height values */
+static int
+read_tile(const struct field *field, float dest[], int stride, int tx, int ty, uint16_t codes[])
+{
+	const struct field_header *header = field->header;
+	if (tx < 0 || ty < 0 || tx >= header->tiles_x || ty >= header->tiles_y) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	const struct field_tile *tile = &field->index[ty*header->tiles_x+tx];
+	int tw = min(header->tile_width, header->width - tx*header->tile_width);
+	int th = min(header->tile_height, header->height - ty*header->tile_height);
+
+	if (tile->offset > field->size || tile->size > field->size - tile->offset) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	if (decode_tile(codes, tw*th, (const unsigned char *)field->map + tile->offset, tile->size, header->flags) < 0) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	if (header->encoding == FIELD_U16) {
+		float q = (tile->hi - tile->lo)*(1.0f/65535.0f);
+		for (int y = 0; y < th; y++) {
+			for (int x = 0; x < tw; x++) dest[y*stride+x] = tile->lo + codes[y*tw+x]*q;
+		}
+	} else {
+		for (int y = 0; y < th; y++) {
+			for (int x = 0; x < tw; x++) dest[y*stride+x] = half_to_float(codes[y*tw+x]);
+		}
+	}
+
+	return 0;
+}
+
+int
+field_read_tile(const struct field *field, float dest[], int stride, int tx, int ty)
+{
+	const struct field_header *header = field->header;
+	uint16_t *codes = malloc(sizeof(uint16_t)*header->tile_width*header->tile_height);
+	if (codes == NULL) return -1;
+
+	int r = read_tile(field, dest, stride, tx, ty, codes);
+	free(codes);
+	return r;
+}
+
+int
+field_read(const struct field *field, float dest[])
+{
+	const struct field_header *header = field->header;
+	uint16_t *codes = malloc(sizeof(uint16_t)*header->tile_width*header->tile_height);
+	if (codes == NULL) return -1;
+
+	for (int ty = 0; ty < header->tiles_y; ty++) {
+		for (int tx = 0; tx < header->tiles_x; tx++) {
+			float *tile = &dest[(size_t)ty*header->tile_height*header->width + tx*header->tile_width];
+			if (read_tile(field, tile, header->width, tx, ty, codes) < 0) {
+				free(codes);
+				return -1;
+			}
+		}
+	}
+
+	free(codes);
+	return 0;
+}
@@ -0,0 +1,69 @@
+/* field.h */
+
+#ifndef _FIELD_H
+#define _FIELD_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* Tile encodings */
+#define FIELD_FP16  0
+#define FIELD_U16   1
+
+/* Flags */
+#define FIELD_DELTA  1  /* Delta + varint compression within each tile */
+
+#define FIELD_MAGIC    "NFLD"
+#define FIELD_VERSION  2
+#define FIELD_MAX_TILE  1024
+
+/* On-disk layout (native byte order): header, tile index, tile data */
+struct field_header {
+	char magic[4];
+	uint16_t version;
+	uint8_t encoding;
+	uint8_t flags;
+	uint32_t width;
+	uint32_t height;
+	uint16_t tile_width;
+	uint16_t tile_height;
+	uint32_t tiles_x;
+	uint32_t tiles_y;
+	uint32_t reserved;  /* Pads the header so the tile index is 8-byte aligned */
+};
+
+struct field_tile {
+	uint64_t offset;
+	uint32_t size;
+	uint32_t reserved;
+	float lo;  /* Quantisation range for FIELD_U16 */
+	float hi;
+};
+
+struct field {
+	void *map;
+	size_t size;
+	const struct field_header *header;
+	const struct field_tile *index;
+};
+
+/* Returns 0 on success, -1 with errno set on failure */
+int
+field_write(const char *path, const float src[], int width, int height, int tile_size, int encoding, int flags);
+
+int
+field_open(struct field *field, const char *path);
+
+void
+field_close(struct field *field);
+
+/* Decode one tile into dest, rows stride floats apart. Edge tiles are
+   clipped to the field size. */
+int
+field_read_tile(const struct field *field, float dest[], int stride, int tx, int ty);
+
+/* Decode the whole field into a width*height raster */
+int
+field_read(const struct field *field, float dest[]);
+
+#endif /* !_FIELD_H */
@@ -0,0 +1,113 @@
+/* frame.c */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <sys/mman.h>
+
+#include "frame.h"
+#include "misc.h"
+
+
+#define ARENA_ALIGN    64
+#define HUGEPAGE_SIZE  (2 << 20)
+
+#define ALIGN(x, a)  (((x) + (a) - 1) & ~((size_t)(a) - 1))
+
+
+static size_t __attribute__ ((const))
+arena_size(int width, int height)
+{
+	size_t size = 0;
+	size += ALIGN(sizeof(float)*width*height, ARENA_ALIGN);
+	size += ALIGN(sizeof(unsigned int)*width*height, ARENA_ALIGN);
+	size += ALIGN(sizeof(unsigned int)*width, ARENA_ALIGN);
+	size += ALIGN(sizeof(unsigned int)*width*width, ARENA_ALIGN);
+	return size;
+}
+
+static void *
+arena_alloc(size_t size, int flags)
+{
+	void *arena = MAP_FAILED;
+
+#ifdef MAP_HUGETLB
+	if (flags & FRAME_HUGEPAGES) {
+		arena = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+	}
+#endif
+
+	if (arena == MAP_FAILED) {
+		arena = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+		if (arena == MAP_FAILED) return NULL;
+#ifdef MADV_HUGEPAGE
+		/* Fall back to transparent huge pages */
+		if (flags & FRAME_HUGEPAGES) madvise(arena, size, MADV_HUGEPAGE);
+#endif
+	}
+
+	return arena;
+}
+
+/* Point the buffers into the arena for the current resolution */
+static void
+arena_carve(struct frame *frame)
+{
+	char *p = frame->arena;
+	int w = frame->width;
+	int h = frame->height;
+
+	frame->noise = (float *)p;
+	p += ALIGN(sizeof(float)*w*h, ARENA_ALIGN);
+	frame->noise_tex = (unsigned int *)p;
+	p += ALIGN(sizeof(unsigned int)*w*h, ARENA_ALIGN);
+	frame->histogram = (unsigned int *)p;
+	p += ALIGN(sizeof(unsigned int)*w, ARENA_ALIGN);
+	frame->histogram_tex = (unsigned int *)p;
+}
+
+int
+frame_init(struct frame *frame, int width, int height, int flags)
+{
+	frame->arena = NULL;
+	frame->arena_size = 0;
+	frame->flags = flags;
+	return frame_resize(frame, width, height);
+}
+
+int
+frame_resize(struct frame *frame, int width, int height)
+{
+	if (width <= 0 || height <= 0) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	size_t size = arena_size(width, height);
+	if (size > frame->arena_size) {
+		/* Grow geometrically so repeated resizes settle quickly */
+		size = ALIGN(max(size, 2*frame->arena_size), HUGEPAGE_SIZE);
+
+		void *arena = arena_alloc(size, frame->flags);
+		if (arena == NULL) return -1;
+
+		if (frame->arena != NULL) munmap(frame->arena, frame->arena_size);
+		frame->arena = arena;
+		frame->arena_size = size;
+	}
+
+	frame->width = width;
+	frame->height = height;
+	frame->valid = 0;
+	arena_carve(frame);
+
+	return 0;
+}
+
+void
+frame_free(struct frame *frame)
+{
+	if (frame->arena != NULL) munmap(frame->arena, frame->arena_size);
+	frame->arena = NULL;
+	frame->arena_size = 0;
+}
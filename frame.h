@@ -0,0 +1,39 @@
+/* frame.h */
+
+#ifndef _FRAME_H
+#define _FRAME_H
+
+#include <stddef.h>
+
+/* Flags */
+#define FRAME_HUGEPAGES  1  /* Back the arena with huge pages if possible */
+
+/* Per-frame buffers, carved out of a single arena so that a frame owns
+   no global state and several frames can be generated concurrently. */
+struct frame {
+	int width;
+	int height;
+	int flags;
+	int valid;  /* Buffers hold a frame generated at this resolution */
+
+	float *noise;                 /* width*height */
+	unsigned int *noise_tex;      /* width*height */
+	unsigned int *histogram;      /* width */
+	unsigned int *histogram_tex;  /* width*width */
+
+	void *arena;
+	size_t arena_size;
+};
+
+/* Returns 0 on success, -1 with errno set on failure */
+int
+frame_init(struct frame *frame, int width, int height, int flags);
+
+/* Change resolution, reusing the arena when it is large enough */
+int
+frame_resize(struct frame *frame, int width, int height);
+
+void
+frame_free(struct frame *frame);
+
+#endif /* !_FRAME_H */
@@ -8,4 +8,7 @@
 
 #define FASTFLOOR(x)  (((x) >= 0) ? (int)(x) : (int)(x)-1)
 
+/* Non-negative remainder of x modulo p */
+#define WRAP(x,p)  ((((x) % (p)) + (p)) % (p))
+
 #endif /* !_MISC_H */
@@ -9,6 +9,10 @@
 
 #include "perlin.h"
 #include "simplex.h"
+#include "worley.h"
+#include "field.h"
+#include "fbm.h"
+#include "frame.h"
 #include "misc.h"
 
 
@@ -17,10 +21,9 @@
 #define SCALE         2
 #define USE_RECT_TEX  0
 
-#define GL_CHECK_ERROR(s)  do { if (glGetError() != GL_NO_ERROR) { fprintf(stderr, "%s: Error at line %i in %s\n", (s), __LINE__, __FILE__); abort(); } } while (0)
-
+#define FIELD_PATH  "noise.fld"
 
-typedef float (*noise3d_func)(float x, float y, float z);
+#define GL_CHECK_ERROR(s)  do { if (glGetError() != GL_NO_ERROR) { fprintf(stderr, "%s: Error at line %i in %s\n", (s), __LINE__, __FILE__); abort(); } } while (0)
 
 
 static float __attribute__ ((const))
@@ -99,9 +102,9 @@ rgba_gradient()
 }
 
 static void
-perlin_map_rgb(unsigned int dest[], const float src[])
+perlin_map_rgb(unsigned int dest[], const float src[], int n)
 {
-	for (int i = 0; i < WIDTH*HEIGHT; i++) dest[i] = rgba_grad[FASTFLOOR(src[i]*(GRAD_WIDTH-1))];
+	for (int i = 0; i < n; i++) dest[i] = rgba_grad[FASTFLOOR(src[i]*(GRAD_WIDTH-1))];
 }
 
 
@@ -178,7 +181,7 @@ setup_opengl()
 GLuint textures[2];
 
 static void
-repaint()
+repaint(const struct frame *frame)
 {
 	/* Bind noise texture */
 	glBindTexture(GL_TEXTURE_2D, textures[0]);
@@ -189,13 +192,13 @@ repaint()
 			glTexCoord2i(0, 0);
 			glVertex2f(0, 0);
 
-			glTexCoord2i(WIDTH, 0);
+			glTexCoord2i(frame->width, 0);
 			glVertex2f(SCALE*WIDTH, 0);
 
-			glTexCoord2i(WIDTH, HEIGHT);
+			glTexCoord2i(frame->width, frame->height);
 			glVertex2f(SCALE*WIDTH, SCALE*HEIGHT);
 
-			glTexCoord2i(0, HEIGHT);
+			glTexCoord2i(0, frame->height);
 			glVertex2f(0, SCALE*HEIGHT);
 		glEnd();
 	} else {
@@ -233,128 +236,248 @@ repaint()
 	glEnd();
 }
 
+/* Noise source for the patterns, periodic with a tile of tile_u by tile_v
+   units if periodic is not NULL */
+struct sampler {
+	noise3d_func noise3d;
+	noise3d_periodic_func periodic;
+	float tile_u;
+	float tile_v;
+	float abs_mean;  /* Expected absolute value of noise3d */
+};
+
+static float
+sample(const struct sampler *s, float fx, float fy, float u, float v, float z)
+{
+	if (s->periodic == NULL) return s->noise3d(fx*u, fy*v, z);
+	return s->periodic(fx*u, fy*v, z, (int)(fx*s->tile_u + 0.5), (int)(fy*s->tile_v + 0.5), 0);
+}
+
+static float
+sample_fbm(const struct sampler *s, float u, float v, float z, float footprint, int octaves, int turbulence)
+{
+	if (s->periodic == NULL) {
+		if (turbulence) return turbulence3d(s->noise3d, u, v, z, footprint, octaves, s->abs_mean);
+		return fbm3d(s->noise3d, u, v, z, footprint, octaves);
+	}
+
+	if (turbulence) return turbulence3d_periodic(s->periodic, u, v, z, footprint, octaves, s->abs_mean, s->tile_u, s->tile_v);
+	return fbm3d_periodic(s->periodic, u, v, z, footprint, octaves, s->tile_u, s->tile_v);
+}
+
+/* Periods of the simplex lattice must be multiples of 3 */
+static int
+period_step(noise3d_periodic_func periodic)
+{
+	return (periodic == simplex3d_periodic) ? 3 : 1;
+}
+
+/* Check that frequencies lo to hi (powers of two apart) give integral
+   periods of at most FBM_MAX_PERIOD over a tile of the given size */
+static int
+tile_periods_ok(float lo, float hi, float tile, int step)
+{
+	float p = lo*tile;
+	int n = (int)(p + 0.5);
+	return n > 0 && fabsf(p - n) < 1e-3 && n % step == 0 && hi*tile <= FBM_MAX_PERIOD;
+}
+
+/* Whether the pattern repeats over a tile of tile_u by tile_v units */
+static int
+pattern_tiles(int type, int octaves, float tile_u, float tile_v, int step)
+{
+	float fx_lo, fx_hi, fy_lo, fy_hi;
+
+	switch (type) {
+	case 0: fx_lo = fx_hi = fy_lo = fy_hi = 1 << 1; break;
+	case 1: fx_lo = fx_hi = 1 << 7; fy_lo = fy_hi = 1 << 6; break;
+	case 2: fx_lo = fx_hi = 1 << 8; fy_lo = fy_hi = 1 << 2; break;
+	case 3: fx_lo = fx_hi = fy_lo = fy_hi = 1 << 4; break;
+	case 4:
+	case 6:
+		fx_lo = fy_lo = 1 << 1;
+		fx_hi = fy_hi = 1 << octaves;
+		break;
+	default:
+		return 0;
+	}
+
+	return tile_periods_ok(fx_lo, fx_hi, tile_u, step) && tile_periods_ok(fy_lo, fy_hi, tile_v, step);
+}
+
 static void
-recalculate_noise(noise3d_func noise3d, int type, float z)
+recalculate_noise(struct frame *frame, noise3d_func noise3d, noise3d_periodic_func periodic, int type, float z, float zoom)
 {
-	static float noise[WIDTH*HEIGHT];
-	static unsigned int noise_tex[WIDTH*HEIGHT];
-	static unsigned int histogram[WIDTH];
-	static unsigned int histogram_tex[WIDTH*WIDTH];
+	const int width = frame->width;
+	const int height = frame->height;
+	float *noise = frame->noise;
+	unsigned int *histogram = frame->histogram;
 
 	/* Reset histogram */
 	unsigned int histogram_max = 0;
-	memset(histogram, 0, sizeof(unsigned int)*WIDTH);
+	memset(histogram, 0, sizeof(unsigned int)*width);
+
+	/* Sample spacing in noise units; octaves are added while zoomed in
+	   and culled at the Nyquist limit while zoomed out */
+	float footprint = 1.0/(zoom*height);
+	int octaves = 4 + max(0, (int)log2f(zoom));
+
+	/* In periodic mode evaluate only the top left quarter when the pattern
+	   repeats over it, and replicate it over the frame */
+	struct sampler s = { noise3d, NULL, 0.0, 0.0, (noise3d == simplex3d) ? SIMPLEX3D_ABS_MEAN : PERLIN3D_ABS_MEAN };
+	int tile_width = width;
+	int tile_height = height;
+	if (periodic != NULL && width % 2 == 0 && height % 2 == 0 &&
+	    pattern_tiles(type, octaves, (width/2)*footprint, (height/2)*footprint, period_step(periodic))) {
+		tile_width = width/2;
+		tile_height = height/2;
+		s.periodic = periodic;
+		s.tile_u = tile_width*footprint;
+		s.tile_v = tile_height*footprint;
+	}
 
 	/* Create noise texture */
-	for (int y = 0; y < HEIGHT; y++) {
-		for (int x = 0; x < WIDTH; x++) {
-			int index = y*WIDTH+x;
+	for (int y = 0; y < tile_height; y++) {
+		for (int x = 0; x < tile_width; x++) {
+			int index = y*width+x;
+			float u = x*footprint;
+			float v = y*footprint;
 			switch (type) {
 			case 0:
-				noise[index] = noise3d(((float)(1 << 1)*x)/HEIGHT, ((float)(1 << 1)*y)/HEIGHT, z);
+				noise[index] = sample(&s, 1 << 1, 1 << 1, u, v, z);
 				noise[index] = 0.5*noise[index] + 0.5;
 				break;
 			case 1:
-				noise[index] = noise3d(((float)(1 << 7)*x)/HEIGHT, ((float)(1 << 6)*y)/HEIGHT, z);
+				noise[index] = sample(&s, 1 << 7, 1 << 6, u, v, z);
 				noise[index] = 0.5*noise[index] + 0.5;
 				break;
 			case 2:
-				noise[index] = noise3d(((float)(1 << 8)*x)/HEIGHT, ((float)(1 << 2)*y)/HEIGHT, z);
+				noise[index] = sample(&s, 1 << 8, 1 << 2, u, v, z);
 				noise[index] = 0.5*noise[index] + 0.5;
 				break;
 			case 3:
-				noise[index] = noise3d(((float)(1 << 4)*x)/HEIGHT, ((float)(1 << 4)*y)/HEIGHT, z);
+				noise[index] = sample(&s, 1 << 4, 1 << 4, u, v, z);
 				noise[index] = 0.5*noise[index] + 0.5;
 				break;
 			case 4:
-				noise[index] = 0;
-				for (int l = 1; l < 5; l++) {
-					noise[index] += (1.0/(1 << l))*noise3d(((float)(1 << l)*x)/HEIGHT, ((float)(1 << l)*y)/HEIGHT, z);
-				}
-				noise[index] = 0.5 * noise[index] * ((float)(1 << 4))/((float)(1 << 4)-1.0) + 0.5;
+				noise[index] = sample_fbm(&s, u, v, z, footprint, octaves, 0);
+				noise[index] = 0.5*noise[index] + 0.5;
 				break;
 			case 5:
 				noise[index] = 0;
 				for (int l = 1; l < 5; l++) {
-					noise[index] += (1.0/(1 << l))*noise3d(((float)(1 << l)*x)/HEIGHT, ((float)(1 << (l*l))*y)/HEIGHT, z);
+					float w = fbm_octave_weight(max(1 << l, 1 << (l*l)), footprint);
+					if (w == 0.0) break;
+					noise[index] += w*(1.0/(1 << l))*noise3d((float)(1 << l)*u, (float)(1 << (l*l))*v, z);
 				}
 				noise[index] = 0.5 * noise[index] * ((float)(1 << 4))/((float)(1 << 4)-1.0) + 0.5;
 				break;
 			case 6:
-				noise[index] = 0;
-				for (int l = 1; l < 5; l++) {
-					noise[index] += fabs((1.0/(1 << l))*noise3d(((float)(1 << l)*x)/HEIGHT, ((float)(1 << l)*y)/HEIGHT, z));
-				}
-				noise[index] = noise[index] * ((float)(1 << 4))/((float)(1 << 4)-1.0) + 0.25;
+				noise[index] = sample_fbm(&s, u, v, z, footprint, octaves, 1);
+				noise[index] = noise[index] + 0.25;
 				break;
 			case 7:
 				noise[index] = 0;
 				for (int l = 1; l < 5; l++) {
-					noise[index] += fabs((1.0/(1 << l))*noise3d(((float)(1 << ((l % 2) ? l*l : l))*x)/HEIGHT, ((float)(1 << ((l % 2) ? l : l*l))*y)/HEIGHT, z));
+					float w = fbm_octave_weight(max(1 << ((l % 2) ? l*l : l), 1 << ((l % 2) ? l : l*l)), footprint);
+					float n = (w > 0.0) ? fabs(noise3d((float)(1 << ((l % 2) ? l*l : l))*u, (float)(1 << ((l % 2) ? l : l*l))*v, z)) : 0.0;
+					noise[index] += (1.0/(1 << l))*(w*n + (1.0 - w)*s.abs_mean);
 				}
 				noise[index] = noise[index] * ((float)(1 << 4))/((float)(1 << 4)-1.0) + 0.25;
 				break;
 			case 8:
-				noise[index] = 0;
-				for (int l = 1; l < 5; l++) {
-					noise[index] += fabs((1.0/(1 << l))*noise3d(((float)(1 << l)*x)/HEIGHT, ((float)(1 << l)*y)/HEIGHT, z));
-				}
-				noise[index] = sinf(-1.0+(1.8*M_PI*y)/HEIGHT + noise[index]);
+				/* Un-normalised octave sum */
+				noise[index] = sample_fbm(&s, u, v, z, footprint, octaves, 1)*(1.0 - 1.0/(1 << octaves));
+				noise[index] = sinf(-1.0+1.8*M_PI*v + noise[index]);
 				noise[index] = 0.5*noise[index] + 0.5;
 				break;
 			case 9:
 				noise[index] = 0.0;
 				for (int l = 1; l < 5; l++) {
-					noise[index] += sinf(((float)l*M_PI*y)/HEIGHT + ((float)(5-l)*M_PI*x)/WIDTH + fabs(noise3d(((float)(1 << l)*x)/HEIGHT, ((float)(1 << l)*y)/HEIGHT, z)));
+					float w = fbm_octave_weight(1 << l, footprint);
+					float n = (w > 0.0) ? fabs(noise3d((float)(1 << l)*u, (float)(1 << l)*v, z)) : 0.0;
+					noise[index] += sinf((float)l*M_PI*v + ((float)(5-l)*M_PI*x)/(zoom*width) + w*n + (1.0 - w)*s.abs_mean);
 				}
 				noise[index] = (1.0/8.0)*noise[index] + 0.5;
 				break;
 			case 10:
 				noise[index] = 0;
 				for (int l = 2; l < 4; l++) {
-					noise[index] += fabs((1.0/l)*noise3d(((float)(1 << l)*x)/HEIGHT, ((float)(1 << l)*y)/HEIGHT, z));
+					float w = fbm_octave_weight(1 << l, footprint);
+					float n = (w > 0.0) ? fabs(noise3d((float)(1 << l)*u, (float)(1 << l)*v, z)) : 0.0;
+					noise[index] += (1.0/l)*(w*n + (1.0 - w)*s.abs_mean);
 				}
-				noise[index] = sinf(-1.0+(0.8*M_PI*y)/HEIGHT + noise[index]);
+				noise[index] = sinf(-1.0+0.8*M_PI*v + noise[index]);
 				noise[index] = 0.5*noise[index] + 0.5;
 				break;
+			case 11:
+				noise[index] = worley3d_f1((float)(1 << 3)*u, (float)(1 << 3)*v, z);
+				noise[index] = min(noise[index], 1.0);
+				break;
+			case 12:
+				noise[index] = worley3d_f2f1((float)(1 << 3)*u, (float)(1 << 3)*v, z);
+				noise[index] = min(2.0*noise[index], 1.0);
+				break;
 			}
 
 			/* Update histogram */
-			unsigned int histogram_index = FASTFLOOR(noise[index]*WIDTH);
-			histogram_index = min(histogram_index, WIDTH-1);
+			unsigned int histogram_index = FASTFLOOR(noise[index]*width);
+			histogram_index = min(histogram_index, width-1);
 			histogram[histogram_index] += 1;
 			histogram_max = max(histogram[histogram_index], histogram_max);
 		}
 	}
 
-	perlin_map_rgb(noise_tex, noise);
+	/* Replicate tile */
+	if (tile_width < width || tile_height < height) {
+		for (int y = 0; y < tile_height; y++) {
+			for (int x = tile_width; x < width; x += tile_width) {
+				memcpy(&noise[y*width+x], &noise[y*width], sizeof(float)*tile_width);
+			}
+		}
+		for (int y = tile_height; y < height; y++) {
+			memcpy(&noise[y*width], &noise[(y-tile_height)*width], sizeof(float)*width);
+		}
+
+		unsigned int tiles = (width/tile_width)*(height/tile_height);
+		for (int i = 0; i < width; i++) histogram[i] *= tiles;
+		histogram_max *= tiles;
+	}
+
+	perlin_map_rgb(frame->noise_tex, noise, width*height);
+
+	/* Create histogram texture */
+	for (int y = 0; y < width; y++) {
+		for (int x = 0; x < width; x++) {
+			int index = y*width+x;
+			if (histogram[x]*(float)width > 8.0*height*(width-y)) frame->histogram_tex[index] = rgba_map((x)/(float)width);
+			else frame->histogram_tex[index] = rgba_f_to_i(0.03, 0.03, 0.03, 1.0);
+		}
+	}
+
+	frame->valid = 1;
+}
 
+static void
+upload_textures(const struct frame *frame)
+{
 	/* Bind noise texture */
 	glBindTexture(GL_TEXTURE_2D, textures[0]);
 	GL_CHECK_ERROR("glBindTextures");
 
 	if (USE_RECT_TEX) {
-		glTexImage2D(GL_TEXTURE_RECTANGLE_ARB, 0, 4, WIDTH, HEIGHT, 0, GL_RGBA, GL_UNSIGNED_BYTE, noise_tex);
+		glTexImage2D(GL_TEXTURE_RECTANGLE_ARB, 0, 4, frame->width, frame->height, 0, GL_RGBA, GL_UNSIGNED_BYTE, frame->noise_tex);
 		GL_CHECK_ERROR("glTexImage2D");
 	} else {
-		glTexImage2D(GL_TEXTURE_2D, 0, 4, WIDTH, HEIGHT, 0, GL_RGBA, GL_UNSIGNED_BYTE, noise_tex);
+		glTexImage2D(GL_TEXTURE_2D, 0, 4, frame->width, frame->height, 0, GL_RGBA, GL_UNSIGNED_BYTE, frame->noise_tex);
 		GL_CHECK_ERROR("glTexImage2D");
 	}
 
-	/* Create histogram texture */
-	for (int y = 0; y < HEIGHT; y++) {
-		for (int x = 0; x < WIDTH; x++) {
-			int index = y*WIDTH+x;
-			if (histogram[x]/8.0 > HEIGHT-y) histogram_tex[index] = rgba_map((x)/(float)WIDTH);
-			else histogram_tex[index] = rgba_f_to_i(0.03, 0.03, 0.03, 1.0);
-		}
-	}
-
 	/* Bind histogram texture */
 	glBindTexture(GL_TEXTURE_2D, textures[1]);
 	GL_CHECK_ERROR("glBindTextures");
 
-	glTexImage2D(GL_TEXTURE_2D, 0, 4, WIDTH, WIDTH, 0, GL_RGBA, GL_UNSIGNED_BYTE, histogram_tex);
+	glTexImage2D(GL_TEXTURE_2D, 0, 4, frame->width, frame->width, 0, GL_RGBA, GL_UNSIGNED_BYTE, frame->histogram_tex);
 }
 
 #define FPS_LIMIT  25
@@ -373,6 +496,15 @@ main_loop()
 	noise3d_func f = perlin3d;
 	printf("Perlin noise\n");
 
+	float zoom = 1.0;
+	int periodic = 0;
+
+	struct frame frame;
+	if (frame_init(&frame, WIDTH, HEIGHT, FRAME_HUGEPAGES) < 0) {
+		perror("frame_init");
+		exit(1);
+	}
+
 	unsigned int t = 0;
 	SDL_Event event;
 	while (1) {
@@ -384,7 +516,7 @@ main_loop()
 					break;
 				case SDL_KEYDOWN:
 					if (event.key.keysym.sym == SDLK_SPACE) {
-						type = (type + 1) % 11;
+						type = (type + 1) % 13;
 					} else if (event.key.keysym.sym == SDLK_n) {
 						if (f == perlin3d) {
 							f = simplex3d;
@@ -393,6 +525,27 @@ main_loop()
 							f = perlin3d;
 							printf("Perlin noise\n");
 						}
+					} else if (event.key.keysym.sym == SDLK_p) {
+						periodic = !periodic;
+						printf("Periodic: %s\n", periodic ? "on" : "off");
+					} else if (event.key.keysym.sym == SDLK_EQUALS) {
+						zoom = min(2.0*zoom, 256.0);
+						printf("Zoom: %g\n", zoom);
+					} else if (event.key.keysym.sym == SDLK_MINUS) {
+						zoom = max(0.5*zoom, 1.0/256.0);
+						printf("Zoom: %g\n", zoom);
+					} else if (event.key.keysym.sym == SDLK_RIGHTBRACKET || event.key.keysym.sym == SDLK_LEFTBRACKET) {
+						int width = (event.key.keysym.sym == SDLK_RIGHTBRACKET) ? 2*frame.width : frame.width/2;
+						int height = (event.key.keysym.sym == SDLK_RIGHTBRACKET) ? 2*frame.height : frame.height/2;
+						if (width >= 32 && width <= 2048 && frame_resize(&frame, width, height) == 0) {
+							printf("Resolution: %ix%i\n", frame.width, frame.height);
+						}
+					} else if (event.key.keysym.sym == SDLK_s && frame.valid) {
+						if (field_write(FIELD_PATH, frame.noise, frame.width, frame.height, 64, FIELD_FP16, FIELD_DELTA) < 0) {
+							perror(FIELD_PATH);
+						} else {
+							printf("Saved %s\n", FIELD_PATH);
+						}
 					}
 					break;
 			}
@@ -401,8 +554,11 @@ main_loop()
 		unsigned int before = SDL_GetTicks();
 
 		/* update the screen */    
-		recalculate_noise(f, type, (10.0*t)/512);
-		repaint();
+		noise3d_periodic_func pf = NULL;
+		if (periodic) pf = (f == perlin3d) ? perlin3d_periodic : simplex3d_periodic;
+		recalculate_noise(&frame, f, pf, type, (10.0*t)/512, zoom);
+		upload_textures(&frame);
+		repaint(&frame);
 		SDL_GL_SwapBuffers();
 		t += 1;
 
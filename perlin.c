@@ -5,6 +5,7 @@
 #include <math.h>
 
 #include "misc.h"
+#include "perlin.h"
 
 
 static const char grad3[][3] = {
@@ -68,6 +69,34 @@ fade(float t)
 	return t*t*t*(t*(t*6-15)+10);
 }
 
+/* Noise within one cell given the wrapped lattice coords of its lower
+   and upper corners along each axis */
+static inline float __attribute__ ((pure, always_inline))
+perlin_cell(const int cx[2], const int cy[2], const int cz[2], float rx, float ry, float rz)
+{
+	/* Calculate gradient indices */
+	unsigned int gi[8];
+	for (int i = 0; i < 8; i++) gi[i] = perm[cx[(i>>2)&1]+perm[cy[(i>>1)&1]+perm[cz[i&1]]]] % 12;
+
+	/* Noise contribution from each corner */
+	float n[8];
+	for (int i = 0; i < 8; i++) n[i] = dot3(grad3[gi[i]], rx - ((i>>2)&1), ry - ((i>>1)&1), rz - (i&1));
+
+	/* Fade curves */
+	float u = fade(rx);
+	float v = fade(ry);
+	float w = fade(rz);
+
+	/* Interpolate */
+	float nx[4];
+	for (int i = 0; i < 4; i++) nx[i] = lerp(n[i], n[4+i], u);
+
+	float nxy[2];
+	for (int i = 0; i < 2; i++) nxy[i] = lerp(nx[i], nx[2+i], v);
+
+	return lerp(nxy[0], nxy[1], w);
+}
+
 float __attribute__ ((pure))
 perlin3d(float x, float y, float z)
 {
@@ -86,25 +115,45 @@ perlin3d(float x, float y, float z)
 	gy = gy & 255;
 	gz = gz & 255;
 
-	/* Calculate gradient indices */
-	unsigned int gi[8];
-	for (int i = 0; i < 8; i++) gi[i] = perm[gx+((i>>2)&1)+perm[gy+((i>>1)&1)+perm[gz+(i&1)]]] % 12;
+	const int cx[2] = { gx, gx+1 };
+	const int cy[2] = { gy, gy+1 };
+	const int cz[2] = { gz, gz+1 };
 
-	/* Noise contribution from each corner */
-	float n[8];
-	for (int i = 0; i < 8; i++) n[i] = dot3(grad3[gi[i]], rx - ((i>>2)&1), ry - ((i>>1)&1), rz - (i&1));
+	return perlin_cell(cx, cy, cz, rx, ry, rz);
+}
 
-	/* Fade curves */
-	float u = fade(rx);
-	float v = fade(ry);
-	float w = fade(rz);
+/* Wrap a lattice coord and its successor to the given period, or to the
+   table size if the period is outside 1 to PERLIN3D_MAX_PERIOD */
+static void
+wrap_period(int c[2], int g, int period)
+{
+	if (period <= 0 || period > PERLIN3D_MAX_PERIOD) {
+		c[0] = g & 255;
+		c[1] = c[0]+1;
+	} else {
+		c[0] = WRAP(g, period);
+		c[1] = (c[0]+1 < period) ? c[0]+1 : 0;
+	}
+}
 
-	/* Interpolate */
-	float nx[4];
-	for (int i = 0; i < 4; i++) nx[i] = lerp(n[i], n[4+i], u);
+float __attribute__ ((pure))
+perlin3d_periodic(float x, float y, float z, int px, int py, int pz)
+{
+	/* Find grid points */
+	int gx = FASTFLOOR(x);
+	int gy = FASTFLOOR(y);
+	int gz = FASTFLOOR(z);
 
-	float nxy[2];
-	for (int i = 0; i < 2; i++) nxy[i] = lerp(nx[i], nx[2+i], v);
+	/* Relative coords within grid cell */
+	float rx = x - gx;
+	float ry = y - gy;
+	float rz = z - gz;
 
-	return lerp(nxy[0], nxy[1], w);
+	/* Wrap cell coords to the period */
+	int cx[2], cy[2], cz[2];
+	wrap_period(cx, gx, px);
+	wrap_period(cy, gy, py);
+	wrap_period(cz, gz, pz);
+
+	return perlin_cell(cx, cy, cz, rx, ry, rz);
 }
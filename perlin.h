@@ -3,7 +3,19 @@
 #ifndef _PERLIN_H
 #define _PERLIN_H
 
+/* Expected absolute value of perlin3d */
+#define PERLIN3D_ABS_MEAN  0.219
+
 float __attribute__ ((pure))
 perlin3d(float x, float y, float z);
 
+/* Largest period supported by perlin3d_periodic (the permutation size) */
+#define PERLIN3D_MAX_PERIOD  256
+
+/* Noise repeating every px, py, pz units along each axis, for periods
+   from 1 to PERLIN3D_MAX_PERIOD. Any other period, including 0, leaves
+   that axis at the default wrap of 256 and is not seamless. */
+float __attribute__ ((pure))
+perlin3d_periodic(float x, float y, float z, int px, int py, int pz);
+
 #endif /* !_PERLIN_H */
@@ -5,6 +5,7 @@
 #include <math.h>
 
 #include "misc.h"
+#include "simplex.h"
 
 
 static const float grad3[][3] = {
@@ -58,8 +59,35 @@ dot3(const float a[], float x, float y, float z)
 
 #define FASTFLOOR(x)  (((x) >= 0) ? (int)(x) : (int)(x)-1)
 
-float __attribute__ ((pure))
-simplex3d(float x, float y, float z)
+/* Hash an integer key into a permutation index, 8 bits at a time */
+static unsigned int __attribute__ ((pure))
+hash_key(int k, unsigned int h)
+{
+	h = perm[((k >> 8) & 255) + h];
+	return perm[(k & 255) + h];
+}
+
+/* Gradient index of the skewed lattice point (i,j,k) for noise repeating
+   with the given periods. The point is hashed by its unskewed position
+   (scaled by 6 to keep it integral), reduced modulo each period, so points
+   one period apart share a gradient. */
+static int __attribute__ ((pure))
+periodic_grad(int i, int j, int k, const int period[3])
+{
+	int s = i+j+k;
+	int kx = 6*i - s;
+	int ky = 6*j - s;
+	int kz = 6*k - s;
+
+	if (period[0] > 0 && period[0] <= SIMPLEX3D_MAX_PERIOD) kx = WRAP(kx, 6*period[0]);
+	if (period[1] > 0 && period[1] <= SIMPLEX3D_MAX_PERIOD) ky = WRAP(ky, 6*period[1]);
+	if (period[2] > 0 && period[2] <= SIMPLEX3D_MAX_PERIOD) kz = WRAP(kz, 6*period[2]);
+
+	return hash_key(kx, hash_key(ky, hash_key(kz, 0))) % 12;
+}
+
+static inline float __attribute__ ((pure, always_inline))
+simplex_noise(float x, float y, float z, const int period[3])
 {
 	/* Skew input space */
 	float s = (x+y+z)*(1.0/3.0);
@@ -115,15 +143,24 @@ simplex3d(float x, float y, float z)
 	float y3 = y0 - 1.0 + 3.0*(1.0/6.0);
 	float z3 = z0 - 1.0 + 3.0*(1.0/6.0);
 
-	int ii = i % 256;
-	int jj = j % 256;
-	int kk = k % 256;
-
 	/* Calculate gradient incides */
-	int gi0 = perm[ii+perm[jj+perm[kk]]] % 12;
-	int gi1 = perm[ii+i1+perm[jj+j1+perm[kk+k1]]] % 12;
-	int gi2 = perm[ii+i2+perm[jj+j2+perm[kk+k2]]] % 12;
-	int gi3 = perm[ii+1+perm[jj+1+perm[kk+1]]] % 12;
+	int gi0, gi1, gi2, gi3;
+
+	if (period == NULL) {
+		int ii = i % 256;
+		int jj = j % 256;
+		int kk = k % 256;
+
+		gi0 = perm[ii+perm[jj+perm[kk]]] % 12;
+		gi1 = perm[ii+i1+perm[jj+j1+perm[kk+k1]]] % 12;
+		gi2 = perm[ii+i2+perm[jj+j2+perm[kk+k2]]] % 12;
+		gi3 = perm[ii+1+perm[jj+1+perm[kk+1]]] % 12;
+	} else {
+		gi0 = periodic_grad(i, j, k, period);
+		gi1 = periodic_grad(i+i1, j+j1, k+k1, period);
+		gi2 = periodic_grad(i+i2, j+j2, k+k2, period);
+		gi3 = periodic_grad(i+1, j+1, k+1, period);
+	}
 
 	/* Calculate contributions */
 	float n0, n1, n2, n3;
@@ -159,3 +196,16 @@ simplex3d(float x, float y, float z)
 	/* Return scaled sum of contributions */
 	return 32.0*(n0 + n1 + n2 + n3);
 }
+
+float __attribute__ ((pure))
+simplex3d(float x, float y, float z)
+{
+	return simplex_noise(x, y, z, NULL);
+}
+
+float __attribute__ ((pure))
+simplex3d_periodic(float x, float y, float z, int px, int py, int pz)
+{
+	const int period[3] = { px, py, pz };
+	return simplex_noise(x, y, z, period);
+}
@@ -3,7 +3,23 @@
 #ifndef _SIMPLEX_H
 #define _SIMPLEX_H
 
+/* Expected absolute value of simplex3d */
+#define SIMPLEX3D_ABS_MEAN  0.351
+
 float __attribute__ ((pure))
 simplex3d(float x, float y, float z);
 
+/* Largest period supported by simplex3d_periodic. Lattice points are
+   hashed by 16-bit keys of 6 times their position, so 6*period must not
+   exceed 65536. */
+#define SIMPLEX3D_MAX_PERIOD  10922
+
+/* Noise repeating every px, py, pz units along each axis, for periods
+   from 1 to SIMPLEX3D_MAX_PERIOD. The simplex lattice only maps onto
+   itself under shifts that are multiples of 3, so a period that is not
+   a multiple of 3 leaves a seam. Any other period, including 0, leaves
+   that axis non-periodic. */
+float __attribute__ ((pure))
+simplex3d_periodic(float x, float y, float z, int px, int py, int pz);
+
 #endif /* !_SIMPLEX_H */
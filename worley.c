@@ -0,0 +1,266 @@
+/* worley.c */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include "misc.h"
+#include "worley.h"
+
+
+/* Same permutation as perlin.c, so cells hash identically */
+static const unsigned char perm[] = {
+	182, 232, 51, 15, 55, 119, 7, 107, 230, 227, 6, 34, 216, 61, 183, 36,
+	40, 134, 74, 45, 157, 78, 81, 114, 145, 9, 209, 189, 147, 58, 126, 0,
+	240, 169, 228, 235, 67, 198, 72, 64, 88, 98, 129, 194, 99, 71, 30, 127,
+	18, 150, 155, 179, 132, 62, 116, 200, 251, 178, 32, 140, 130, 139, 250, 26,
+	151, 203, 106, 123, 53, 255, 75, 254, 86, 234, 223, 19, 199, 244, 241, 1,
+	172, 70, 24, 97, 196, 10, 90, 246, 252, 68, 84, 161, 236, 205, 80, 91,
+	233, 225, 164, 217, 239, 220, 20, 46, 204, 35, 31, 175, 154, 17, 133, 117,
+	73, 224, 125, 65, 77, 173, 3, 2, 242, 221, 120, 218, 56, 190, 166, 11,
+	138, 208, 231, 50, 135, 109, 213, 187, 152, 201, 47, 168, 185, 186, 167, 165,
+	102, 153, 156, 49, 202, 69, 195, 92, 21, 229, 63, 104, 197, 136, 148, 94,
+	171, 93, 59, 149, 23, 144, 160, 57, 76, 141, 96, 158, 163, 219, 237, 113,
+	206, 181, 112, 111, 191, 137, 207, 215, 13, 83, 238, 249, 100, 131, 118, 243,
+	162, 248, 43, 66, 226, 27, 211, 95, 214, 105, 108, 101, 170, 128, 210, 87,
+	38, 44, 174, 188, 176, 39, 14, 143, 159, 16, 124, 222, 33, 247, 37, 245,
+	8, 4, 22, 82, 110, 180, 184, 12, 25, 5, 193, 41, 85, 177, 192, 253,
+	79, 29, 115, 103, 142, 146, 52, 48, 89, 54, 121, 212, 122, 60, 28, 42,
+
+	182, 232, 51, 15, 55, 119, 7, 107, 230, 227, 6, 34, 216, 61, 183, 36,
+	40, 134, 74, 45, 157, 78, 81, 114, 145, 9, 209, 189, 147, 58, 126, 0,
+	240, 169, 228, 235, 67, 198, 72, 64, 88, 98, 129, 194, 99, 71, 30, 127,
+	18, 150, 155, 179, 132, 62, 116, 200, 251, 178, 32, 140, 130, 139, 250, 26,
+	151, 203, 106, 123, 53, 255, 75, 254, 86, 234, 223, 19, 199, 244, 241, 1,
+	172, 70, 24, 97, 196, 10, 90, 246, 252, 68, 84, 161, 236, 205, 80, 91,
+	233, 225, 164, 217, 239, 220, 20, 46, 204, 35, 31, 175, 154, 17, 133, 117,
+	73, 224, 125, 65, 77, 173, 3, 2, 242, 221, 120, 218, 56, 190, 166, 11,
+	138, 208, 231, 50, 135, 109, 213, 187, 152, 201, 47, 168, 185, 186, 167, 165,
+	102, 153, 156, 49, 202, 69, 195, 92, 21, 229, 63, 104, 197, 136, 148, 94,
+	171, 93, 59, 149, 23, 144, 160, 57, 76, 141, 96, 158, 163, 219, 237, 113,
+	206, 181, 112, 111, 191, 137, 207, 215, 13, 83, 238, 249, 100, 131, 118, 243,
+	162, 248, 43, 66, 226, 27, 211, 95, 214, 105, 108, 101, 170, 128, 210, 87,
+	38, 44, 174, 188, 176, 39, 14, 143, 159, 16, 124, 222, 33, 247, 37, 245,
+	8, 4, 22, 82, 110, 180, 184, 12, 25, 5, 193, 41, 85, 177, 192, 253,
+	79, 29, 115, 103, 142, 146, 52, 48, 89, 54, 121, 212, 122, 60, 28, 42
+};
+
+
+/* Neighbour cell offsets ordered by increasing minimum distance
+   (centre, faces, edges, corners) so the distance bound prunes early. */
+static const signed char cell_offset[27][3] = {
+	{ 0, 0, 0 },
+
+	{ -1, 0, 0 }, { 1, 0, 0 }, { 0, -1, 0 }, { 0, 1, 0 }, { 0, 0, -1 }, { 0, 0, 1 },
+
+	{ -1, -1, 0 }, { 1, -1, 0 }, { -1, 1, 0 }, { 1, 1, 0 },
+	{ -1, 0, -1 }, { 1, 0, -1 }, { -1, 0, 1 }, { 1, 0, 1 },
+	{ 0, -1, -1 }, { 0, 1, -1 }, { 0, -1, 1 }, { 0, 1, 1 },
+
+	{ -1, -1, -1 }, { 1, -1, -1 }, { -1, 1, -1 }, { 1, 1, -1 },
+	{ -1, -1, 1 }, { 1, -1, 1 }, { -1, 1, 1 }, { 1, 1, 1 }
+};
+
+
+/* Feature point of cell (gx,gy,gz) relative to the cell origin */
+static void
+feature_point(int gx, int gy, int gz, float p[3])
+{
+	unsigned int h = perm[(gx & 255)+perm[(gy & 255)+perm[gz & 255]]];
+
+	/* Chain the hash per axis so neighbouring hashes don't share coords */
+	unsigned int hx = perm[h];
+	unsigned int hy = perm[hx+1];
+	unsigned int hz = perm[hy+2];
+
+	p[0] = (hx + 0.5f)*(1.0f/256.0f);
+	p[1] = (hy + 0.5f)*(1.0f/256.0f);
+	p[2] = (hz + 0.5f)*(1.0f/256.0f);
+}
+
+/* Squared distance from the relative coord r to the nearest face of the
+   neighbour cell at offset d (-1, 0 or 1) along one axis */
+static float __attribute__ ((const))
+axis_bound(float r, int d)
+{
+	if (d < 0) return r*r;
+	if (d > 0) return (1-r)*(1-r);
+	return 0.0;
+}
+
+static void
+worley3d_sq(float x, float y, float z, float f[2])
+{
+	/* Find grid cell */
+	int gx = FASTFLOOR(x);
+	int gy = FASTFLOOR(y);
+	int gz = FASTFLOOR(z);
+
+	/* Relative coords within grid cell */
+	float rx = x - gx;
+	float ry = y - gy;
+	float rz = z - gz;
+
+	float f1 = INFINITY;
+	float f2 = INFINITY;
+
+	for (int i = 0; i < 27; i++) {
+		int dx = cell_offset[i][0];
+		int dy = cell_offset[i][1];
+		int dz = cell_offset[i][2];
+
+		/* Skip cells that cannot hold a point closer than F2 */
+		float bound = axis_bound(rx, dx) + axis_bound(ry, dy) + axis_bound(rz, dz);
+		if (bound >= f2) continue;
+
+		float p[3];
+		feature_point(gx+dx, gy+dy, gz+dz, p);
+
+		float ex = dx + p[0] - rx;
+		float ey = dy + p[1] - ry;
+		float ez = dz + p[2] - rz;
+		float d = ex*ex + ey*ey + ez*ez;
+
+		if (d < f1) {
+			f2 = f1;
+			f1 = d;
+		} else if (d < f2) {
+			f2 = d;
+		}
+	}
+
+	f[0] = f1;
+	f[1] = f2;
+}
+
+void
+worley3d(float x, float y, float z, float f[2])
+{
+	worley3d_sq(x, y, z, f);
+	f[0] = sqrtf(f[0]);
+	f[1] = sqrtf(f[1]);
+}
+
+float __attribute__ ((pure))
+worley3d_f1(float x, float y, float z)
+{
+	float f[2];
+	worley3d(x, y, z, f);
+	return f[0];
+}
+
+float __attribute__ ((pure))
+worley3d_f2(float x, float y, float z)
+{
+	float f[2];
+	worley3d(x, y, z, f);
+	return f[1];
+}
+
+float __attribute__ ((pure))
+worley3d_f2f1(float x, float y, float z)
+{
+	float f[2];
+	worley3d(x, y, z, f);
+	return f[1] - f[0];
+}
+
+static float __attribute__ ((const))
+select_output(float f1, float f2, int output)
+{
+	switch (output) {
+	case WORLEY_F1: return f1;
+	case WORLEY_F2: return f2;
+	default: return f2 - f1;
+	}
+}
+
+#ifdef __SSE2__
+/* Evaluate four points at once. Feature points are gathered per lane,
+   distances and the F1/F2 update run in vector registers, and a cell is
+   skipped only when its bound exceeds F2 in every lane. */
+static void
+worley3d_x4(float dest[], const float x[], const float y[], const float z[], int output)
+{
+	int gx[4], gy[4], gz[4];
+	float rx[4], ry[4], rz[4];
+
+	for (int l = 0; l < 4; l++) {
+		gx[l] = FASTFLOOR(x[l]);
+		gy[l] = FASTFLOOR(y[l]);
+		gz[l] = FASTFLOOR(z[l]);
+		rx[l] = x[l] - gx[l];
+		ry[l] = y[l] - gy[l];
+		rz[l] = z[l] - gz[l];
+	}
+
+	__m128 vrx = _mm_loadu_ps(rx);
+	__m128 vry = _mm_loadu_ps(ry);
+	__m128 vrz = _mm_loadu_ps(rz);
+	__m128 one = _mm_set1_ps(1.0f);
+	__m128 zero = _mm_setzero_ps();
+
+	/* Per-axis bounds for offsets -1 and +1 */
+	__m128 lo[3] = { _mm_mul_ps(vrx, vrx), _mm_mul_ps(vry, vry), _mm_mul_ps(vrz, vrz) };
+	__m128 hi[3];
+	hi[0] = _mm_sub_ps(one, vrx); hi[0] = _mm_mul_ps(hi[0], hi[0]);
+	hi[1] = _mm_sub_ps(one, vry); hi[1] = _mm_mul_ps(hi[1], hi[1]);
+	hi[2] = _mm_sub_ps(one, vrz); hi[2] = _mm_mul_ps(hi[2], hi[2]);
+
+	__m128 f1 = _mm_set1_ps(INFINITY);
+	__m128 f2 = _mm_set1_ps(INFINITY);
+
+	for (int i = 0; i < 27; i++) {
+		int dx = cell_offset[i][0];
+		int dy = cell_offset[i][1];
+		int dz = cell_offset[i][2];
+
+		__m128 bound = _mm_add_ps(_mm_add_ps(dx < 0 ? lo[0] : (dx > 0 ? hi[0] : zero),
+						     dy < 0 ? lo[1] : (dy > 0 ? hi[1] : zero)),
+					  dz < 0 ? lo[2] : (dz > 0 ? hi[2] : zero));
+		if (_mm_movemask_ps(_mm_cmplt_ps(bound, f2)) == 0) continue;
+
+		float px[4], py[4], pz[4];
+		for (int l = 0; l < 4; l++) {
+			float p[3];
+			feature_point(gx[l]+dx, gy[l]+dy, gz[l]+dz, p);
+			px[l] = p[0];
+			py[l] = p[1];
+			pz[l] = p[2];
+		}
+
+		__m128 ex = _mm_sub_ps(_mm_add_ps(_mm_set1_ps(dx), _mm_loadu_ps(px)), vrx);
+		__m128 ey = _mm_sub_ps(_mm_add_ps(_mm_set1_ps(dy), _mm_loadu_ps(py)), vry);
+		__m128 ez = _mm_sub_ps(_mm_add_ps(_mm_set1_ps(dz), _mm_loadu_ps(pz)), vrz);
+		__m128 d = _mm_add_ps(_mm_add_ps(_mm_mul_ps(ex, ex), _mm_mul_ps(ey, ey)), _mm_mul_ps(ez, ez));
+
+		f2 = _mm_min_ps(f2, _mm_max_ps(f1, d));
+		f1 = _mm_min_ps(f1, d);
+	}
+
+	float r1[4], r2[4];
+	_mm_storeu_ps(r1, _mm_sqrt_ps(f1));
+	_mm_storeu_ps(r2, _mm_sqrt_ps(f2));
+	for (int l = 0; l < 4; l++) dest[l] = select_output(r1[l], r2[l], output);
+}
+#endif
+
+void
+worley3d_batch(float dest[], const float x[], const float y[], const float z[], int n, int output)
+{
+	int i = 0;
+
+#ifdef __SSE2__
+	for (; i + 4 <= n; i += 4) worley3d_x4(&dest[i], &x[i], &y[i], &z[i], output);
+#endif
+
+	for (; i < n; i++) {
+		float f[2];
+		worley3d(x[i], y[i], z[i], f);
+		dest[i] = select_output(f[0], f[1], output);
+	}
+}
@@ -0,0 +1,29 @@
+/* worley.h */
+
+#ifndef _WORLEY_H
+#define _WORLEY_H
+
+/* Outputs for worley3d_batch */
+#define WORLEY_F1    0
+#define WORLEY_F2    1
+#define WORLEY_F2F1  2
+
+/* Distances to the nearest (f[0]) and second nearest (f[1]) feature point.
+   Only the 3x3x3 neighbouring cells are searched, so F1 is exact but F2
+   can rarely miss a closer point two cells away. */
+void
+worley3d(float x, float y, float z, float f[2]);
+
+float __attribute__ ((pure))
+worley3d_f1(float x, float y, float z);
+
+float __attribute__ ((pure))
+worley3d_f2(float x, float y, float z);
+
+float __attribute__ ((pure))
+worley3d_f2f1(float x, float y, float z);
+
+void
+worley3d_batch(float dest[], const float x[], const float y[], const float z[], int n, int output);
+
+#endif /* !_WORLEY_H */